@@ -2,6 +2,7 @@
 #include "lxPlatform.h"
 
 #include <memory>
+#include <stdlib.h>
 
 
 using namespace lx;
@@ -20,7 +21,7 @@ void* StackAllocator::allocateStack	(u32 size, u32 alignment) {
 	// 2. Compute the distance to the next aligned part.
 	// 3. If already aligned, no offset
 
-	u32 alignmentMiss = ((u32)m_currPtr) & (alignment - 1);
+	u32 alignmentMiss = ((u32)(size_t)m_currPtr) & (alignment - 1);
 	// Branchless alignment adjustement.
 	// Shift 0 or 32 bit -> Same as multiply by 1 or 0 -> Same as if (cond) { a } else { 0 }
 	alignmentMiss = (alignment - alignmentMiss) >> ((alignmentMiss == 0)<<5); 
@@ -54,7 +55,7 @@ void* StackAllocator::allocateStackMT(u32 size, u32 alignment) {
 	// Perform increment FIRST.
 	u8* before = (u8*)ATOMICINCREMENTPTR(&m_currPtrAtomic,size);
 
-	u32 alignmentMiss = ((u32)before) & (alignment - 1);
+	u32 alignmentMiss = ((u32)(size_t)before) & (alignment - 1);
 	alignmentMiss = (alignment - alignmentMiss); // We already over allocated anyway, avoid multiply to restrict.
 
 	if (before + size <= m_endPtr) {
@@ -326,7 +327,12 @@ void* StandardAllocator::allocateStd	(u32 size, u32 alignment) {
 	if (alignment <= sizeof(int)) {
 		return std::malloc(size);
 	} else {
+#if defined(USE_WINDOWS_API)
 		return _aligned_malloc(size, alignment);
+#else
+		void* ptr;
+		return (posix_memalign(&ptr, alignment, size) == 0) ? ptr : NULL;
+#endif
 	}
 }
 
@@ -15,6 +15,9 @@
 	- TrashRing Allocator	: same as stack allocator, except that it loops at the end of the buffer and overwrite.
 	- Pool Allocator		: allow to allocate item only of fixed size.
 
+	lxMallocOverride.cpp build a shared library replacing malloc/free and operator new/delete
+	of a whole process (LD_PRELOAD) with per thread pools. See the comment in this file.
+
 	1/ User can extend new allocator very easily.
 
 	2/ The concept is to provide extremly minimal overhead, high performance code.
@@ -122,7 +125,7 @@ protected:
 	Of course fully 64 bit, no limitation except OS. */
 class StandardAllocator : public IAllocator {
 public:
-	StandardAllocator::StandardAllocator() {
+	StandardAllocator() {
 		m_allocateFunc = (IAllocator::__allocate)&StandardAllocator::allocateStd;
 		m_freeFunc     = (IAllocator::__free    )&StandardAllocator::freeStd;
 		m_internalStatus.m_activeMallocCount	= Status::UNAVAILABLE;
@@ -0,0 +1,719 @@
+/*
+	malloc / operator new replacement built on lx allocators.
+	==========================================================
+
+	Replace the process allocator WITHOUT changing the source of the application :
+	malloc, free, calloc, realloc, reallocarray, posix_memalign, aligned_alloc, memalign,
+	valloc, pvalloc, malloc_usable_size and all global operator new / delete.
+
+	Build (POSIX, GNU C++ / Clang) :
+
+		g++ -std=c++17 -O2 -fPIC -shared -fvisibility=hidden -fno-builtin-malloc -fno-builtin-free	\
+			lxAllocators.cpp lxMallocOverride.cpp -o liblxmalloc.so -lpthread
+
+	-fvisibility=hidden : only malloc family and operators are exported, lx allocators internals
+	can not interpose (or be interposed by) symbols of the application.
+	C++17 is needed for the sized and aligned operator new / delete (not compiled with older standard).
+
+	Use :
+
+		LD_PRELOAD=./liblxmalloc.so ./application		(no relink needed)
+		g++ ... -L. -llxmalloc								(or link it directly)
+
+	Test and benchmark (stress cross thread free, thread exit, fork, realloc, calloc and report
+	allocation per second, run it with and without LD_PRELOAD to compare with the system allocator) :
+
+		g++ -std=c++17 -O2 -fno-builtin lxMallocTest.cpp -o lxMallocTest -lpthread
+		LD_PRELOAD=./liblxmalloc.so ./lxMallocTest
+
+	Design :
+
+	- Small size (<= LX_MALLOC_SMALL_MAX) are rounded to a size class (16 byte step up to 128,
+	  then 4 step per power of 2) and served by a single thread PoolAllocator.
+	  Each thread owns its own heap (a set of pools per class) : allocation and free from
+	  the owner thread never lock and never use atomics.
+
+	- Only pools with free items are kept in the heap list of a class (current pool is the head),
+	  a full pool is removed and come back when one of its block is freed.
+	  A pool becoming completely free (and not the current one) is kept aside as a spare pool of
+	  its class, reused before mapping a new one. When the spare pools of a heap exceed
+	  LX_MALLOC_SPARE_MAX byte, the least recently released ones are unmapped.
+	  Idle memory of a heap is bounded by one current pool per class + LX_MALLOC_SPARE_MAX.
+
+	- A block freed by another thread is pushed on a lockless stack owned by its pool,
+	  the first push also queue the pool on a lockless stack of its heap.
+	  The owner thread get them back when its current pool is empty.
+
+	- Only large size (> LX_MALLOC_SMALL_MAX, 256KB, above glibc default mmap threshold) are mapped
+	  directly with mmap (realloc use mremap when available).
+	  On free, the heap of the freeing thread keep the last mappings (up to LX_MALLOC_LARGE_CACHE_COUNT and
+	  LX_MALLOC_LARGE_CACHE_SIZE byte) and reuse them for a later allocation of close size,
+	  oldest ones are unmapped.
+
+	- Each block is preceded by a BlockHeader (2 pointers), giving the pool owning the block in O(1) on free.
+	  NOTE : Overhead is 16 byte per small allocation (64 bit).
+
+	- TLS init safe : heap pointer is a zero initialized initial-exec TLS variable, no constructor,
+	  no __tls_get_addr call. Heap and pool memory come from mmap, never from malloc,
+	  so there is no recursion during the first allocation of the process or of a thread.
+	  (Library is meant to be preloaded or linked, not dlopen'ed)
+
+	- Fork safe : there is NO lock at all in this file. The heap list is push only and
+	  heap ownership is taken with a compare and swap, so the child never wait on a lock
+	  owned by a thread that does not exist anymore.
+	  Heaps of the other threads of the parent are never adopted by the child (they may be in the
+	  middle of an operation), their blocks can still be freed safely from the child.
+
+	- When a thread exit, its heap is released and adopted by the next created thread.
+	  The thread never take a heap again : allocation done after that by a later TSD destructor
+	  are mapped directly (rare, slow but safe) and its frees use the remote path.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		// mremap, must be defined before any system header.
+#endif
+
+#include "lxAllocators.h"
+#include "lxPlatform.h"
+
+#if !defined(USE_WINDOWS_API)
+
+#include <new>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+using namespace lx;
+
+#define LX_EXPORT			extern "C" __attribute__((visibility("default")))
+
+// Bigger than this go to mmap. Keep medium size in pools, a mmap/munmap per allocation is very slow.
+#define LX_MALLOC_SMALL_MAX		(256*1024)
+// Minimum alignment returned by malloc.
+#define LX_MALLOC_ALIGN			(16)
+// Approximate memory size of a pool, pool for big class have at least LX_MALLOC_MIN_ITEM items.
+#define LX_MALLOC_POOL_SIZE		(256*1024)
+#define LX_MALLOC_MIN_ITEM		(8)
+// Freed large mappings kept per heap, for reuse.
+#define LX_MALLOC_LARGE_CACHE_COUNT	(8)
+#define LX_MALLOC_LARGE_CACHE_SIZE	(32*1024*1024)
+// Empty pools kept per heap (all classes), avoid map/unmap when the number of live blocks oscillate.
+#define LX_MALLOC_SPARE_MAX		(4*1024*1024)
+// 8 class of 16 byte (16..128), then 4 class per power of 2 (160..262144).
+#define LX_MALLOC_CLASS_COUNT	(8 + 4*11)
+
+namespace {
+
+struct Heap;
+
+struct Page {
+	PoolAllocator	m_pool;			// Single thread pool, only used by the owner heap.
+	Heap*			m_heap;
+	Page*			m_next;			// Next/previous page of the same class with free items. (not used when full)
+	Page*			m_prev;
+	void* volatile	m_remoteFree;	// Lockless stack of blocks freed by other threads.
+	Page*			m_remoteNext;	// Next page in Heap::m_remotePages.
+	Page*			m_lruNext;		// Spare page only : newer/older spare page of the heap, all classes.
+	Page*			m_lruPrev;
+	size_t			m_mapSize;
+	u32				m_classSize;
+	u32				m_sizeClass;
+	u32				m_used;			// Allocated block count, include remote free not collected yet.
+	bool			m_full;			// Not in Heap::m_pages when true.
+};
+
+struct Heap {
+	Page*			m_pages	[LX_MALLOC_CLASS_COUNT];	// Pages with free items, head is the current one.
+	Page*			m_spare	[LX_MALLOC_CLASS_COUNT];	// Empty pages out of the list (linked with m_next/m_prev).
+	Page*			m_spareNew;		// Spare pages of all classes, in release order (linked with m_lruNext/m_lruPrev).
+	Page*			m_spareOld;
+	size_t			m_spareSize;	// Total map size of spare pages.
+	u8*				m_largeCache[LX_MALLOC_LARGE_CACHE_COUNT];	// Freed large mappings, oldest first.
+	u32				m_largeCount;
+	size_t			m_largeSize;	// Total map size of cached mappings.
+	void* volatile	m_remotePages;	// Lockless stack of pages receiving their first remote free.
+	Heap*			m_next;			// Global list of heaps, push only.
+	void* volatile	m_owned;		// NULL when free for adoption.
+};
+
+/** Placed just before each pointer returned to the user.
+	m_owner == NULL for a large (mmap) allocation, then m_block is the mapping base,
+	first size_t of the mapping is the mapping size and second one is not zero if the mapping
+	was reused from the cache (memory not zeroed). */
+struct BlockHeader {
+	Page*	m_owner;
+	void*	m_block;
+};
+
+#define LX_LARGE_OFFSET		(2 * sizeof(BlockHeader))	// Mapping size + reused flag, then header.
+
+Heap* volatile		s_heapList	= NULL;
+pthread_key_t		s_heapKey;
+pthread_once_t		s_heapKeyOnce = PTHREAD_ONCE_INIT;
+
+__thread Heap*		s_heap		__attribute__((tls_model("initial-exec"))) = NULL;
+__thread bool		s_exiting	__attribute__((tls_model("initial-exec"))) = false;	// Heap released at thread exit.
+
+inline size_t alignUp(size_t v, size_t alignment) {
+	return (v + (alignment - 1)) & ~(alignment - 1);
+}
+
+inline size_t pageSize() {
+	static size_t s_pageSize = 0;	// Benign race, always same value.
+	if (s_pageSize == 0) { s_pageSize = (size_t)sysconf(_SC_PAGESIZE); }
+	return s_pageSize;
+}
+
+inline void* mapMemory(size_t size) {
+	void* res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (res == MAP_FAILED) ? NULL : res;
+}
+
+inline u32 sizeToClass(size_t size) {
+	if (size <= 128) {
+		return (size <= 16) ? 0 : (u32)((size - 1) >> 4);
+	}
+	u32 s   = (u32)(size - 1);
+	u32 bit = 31 - __builtin_clz(s);				// >= 7
+	return 8 + ((bit - 7) << 2) + ((s >> (bit - 2)) & 3);
+}
+
+inline u32 classToSize(u32 sizeClass) {
+	if (sizeClass < 8) {
+		return (sizeClass + 1) << 4;
+	}
+	u32 bit = 7 + ((sizeClass - 8) >> 2);
+	u32 sub = ((sizeClass - 8) & 3) + 1;
+	return (1 << bit) + (sub << (bit - 2));
+}
+
+//
+// Heap ownership
+//
+
+void releaseHeap(void* heap) {
+	// Called at thread exit.
+	s_exiting	= true;
+	s_heap		= NULL;
+	__sync_synchronize();	// Publish single thread state of the pools before releasing.
+	((Heap*)heap)->m_owned = NULL;
+}
+
+void createHeapKey() {
+	pthread_key_create(&s_heapKey, releaseHeap);
+}
+
+Heap* acquireHeap() {
+	if (s_exiting) { return NULL; }	// Would never be released again.
+
+	pthread_once(&s_heapKeyOnce, createHeapKey);
+
+	Heap* heap;
+	// Adopt a heap released by an exited thread.
+	for (heap = s_heapList; heap; heap = heap->m_next) {
+		if (heap->m_owned == NULL && ATOMICCASPTR(&heap->m_owned, NULL, (void*)heap) == NULL) {
+			break;
+		}
+	}
+
+	if (!heap) {
+		heap = (Heap*)mapMemory(alignUp(sizeof(Heap), pageSize()));	// Zeroed by mmap.
+		if (!heap) { return NULL; }
+		heap->m_owned = heap;
+		Heap* head;
+		do {
+			head		= s_heapList;
+			heap->m_next	= head;
+		} while (ATOMICCASPTR(&s_heapList, head, heap) != head);
+	}
+
+	// Set TLS before setspecific : in case it would allocate, we do not recurse here.
+	s_heap = heap;
+	pthread_setspecific(s_heapKey, heap);
+	return heap;
+}
+
+//
+// Small allocation
+//
+
+inline void pushPage(Heap* heap, Page* page) {
+	Page* head		= heap->m_pages[page->m_sizeClass];
+	page->m_prev	= NULL;
+	page->m_next	= head;
+	if (head) { head->m_prev = page; }
+	heap->m_pages[page->m_sizeClass] = page;
+}
+
+void removeSpare(Heap* heap, Page* page) {
+	if (page->m_prev)		{ page->m_prev->m_next = page->m_next;		} else { heap->m_spare[page->m_sizeClass] = page->m_next; }
+	if (page->m_next)		{ page->m_next->m_prev = page->m_prev;		}
+	if (page->m_lruPrev)	{ page->m_lruPrev->m_lruNext = page->m_lruNext;	} else { heap->m_spareOld = page->m_lruNext; }
+	if (page->m_lruNext)	{ page->m_lruNext->m_lruPrev = page->m_lruPrev;	} else { heap->m_spareNew = page->m_lruPrev; }
+	heap->m_spareSize -= page->m_mapSize;
+}
+
+Page* createPage(Heap* heap, u32 sizeClass) {
+	Page* page = heap->m_spare[sizeClass];
+	if (page) {
+		removeSpare(heap, page);
+		pushPage(heap, page);
+		return page;
+	}
+
+	u32 classSize	= classToSize(sizeClass);
+	u32 itemSize	= classSize + sizeof(BlockHeader);
+	u32 itemCount	= LX_MALLOC_POOL_SIZE / itemSize;
+	if (itemCount < LX_MALLOC_MIN_ITEM) { itemCount = LX_MALLOC_MIN_ITEM; }
+
+	size_t headerSize	= alignUp(sizeof(Page), 64);
+	size_t mapSize		= alignUp(headerSize + (size_t)PoolAllocator::getMemoryAmount(itemSize, itemCount, LX_MALLOC_ALIGN), pageSize());
+
+	u8* mem = (u8*)mapMemory(mapSize);
+	if (!mem) { return NULL; }
+
+	page			= (Page*)mem;
+	new (&page->m_pool) PoolAllocator(&mem[headerSize], itemSize, itemCount, LX_MALLOC_ALIGN, false);
+	page->m_heap		= heap;
+	page->m_remoteFree	= NULL;
+	page->m_remoteNext	= NULL;
+	page->m_mapSize		= mapSize;
+	page->m_classSize	= classSize;
+	page->m_sizeClass	= sizeClass;
+	page->m_used		= 0;
+	page->m_full		= false;
+	pushPage(heap, page);
+	return page;
+}
+
+/** Owner thread only : empty page out of the list, kept as spare of its class.
+	Oldest spare pages are unmapped when over budget. */
+void releasePage(Heap* heap, Page* page) {
+	// No block left, so no other thread can reference the page. Never the head : m_prev is valid.
+	page->m_prev->m_next = page->m_next;
+	if (page->m_next) { page->m_next->m_prev = page->m_prev; }
+
+	Page* head		= heap->m_spare[page->m_sizeClass];
+	page->m_prev	= NULL;
+	page->m_next	= head;
+	if (head) { head->m_prev = page; }
+	heap->m_spare[page->m_sizeClass] = page;
+
+	page->m_lruNext	= NULL;
+	page->m_lruPrev	= heap->m_spareNew;
+	if (heap->m_spareNew) { heap->m_spareNew->m_lruNext = page; } else { heap->m_spareOld = page; }
+	heap->m_spareNew	= page;
+	heap->m_spareSize	+= page->m_mapSize;
+
+	while (heap->m_spareSize > LX_MALLOC_SPARE_MAX) {
+		Page* old = heap->m_spareOld;
+		removeSpare(heap, old);
+		munmap(old, old->m_mapSize);
+	}
+}
+
+/** Owner thread only : free a block of its own page.
+	Page come back in the list if it was full, and is released when empty and not the current one. */
+inline void freeLocal(Heap* heap, Page* page, void* block) {
+	page->m_pool.free(block);
+	page->m_used--;
+	if (page->m_full) {
+		page->m_full = false;
+		pushPage(heap, page);
+		// Previous current page is not the head anymore.
+		if (page->m_next && page->m_next->m_used == 0) { releasePage(heap, page->m_next); }
+	} else if (page->m_used == 0 && heap->m_pages[page->m_sizeClass] != page) {
+		releasePage(heap, page);
+	}
+}
+
+void collectRemoteFree(Heap* heap) {
+	if (!heap->m_remotePages) { return; }
+
+	Page* page = (Page*)ATOMICEXCHANGEPTR(&heap->m_remotePages, NULL);
+	while (page) {
+		// Read next first : as soon as remoteFree is emptied, another thread may queue the page again.
+		Page* next	= page->m_remoteNext;
+		void* block	= ATOMICEXCHANGEPTR(&page->m_remoteFree, NULL);
+		while (block) {
+			void* nextBlock = *(void**)block;
+			freeLocal(heap, page, block);
+			block = nextBlock;
+		}
+		page = next;
+	}
+}
+
+void* allocateBlockSlow(Heap* heap, u32 sizeClass, Page** owner) {
+	collectRemoteFree(heap);
+
+	// Full pages leave the list, so each page is tested only once until a free make room in it.
+	Page* page;
+	while ((page = heap->m_pages[sizeClass])) {
+		void* block = page->m_pool.allocate(0);
+		if (block) {
+			page->m_used++;
+			*owner = page;
+			return block;
+		}
+		page->m_full = true;
+		heap->m_pages[sizeClass] = page->m_next;
+		if (page->m_next) { page->m_next->m_prev = NULL; }
+	}
+
+	page = createPage(heap, sizeClass);
+	if (!page) { return NULL; }
+	page->m_used++;
+	*owner = page;
+	return page->m_pool.allocate(0);
+}
+
+/** Return a free block of the given class, block start with room for a BlockHeader. */
+inline void* allocateBlock(u32 sizeClass, Page** owner) {
+	Heap* heap = s_heap;
+	if (!heap) {
+		heap = acquireHeap();
+		if (!heap) { return NULL; }
+	}
+
+	Page* page = heap->m_pages[sizeClass];
+	if (page) {
+		void* block = page->m_pool.allocate(0);
+		if (block) {
+			page->m_used++;
+			*owner = page;
+			return block;
+		}
+	}
+	return allocateBlockSlow(heap, sizeClass, owner);
+}
+
+void freeBlock(Page* page, void* block) {
+	Heap* heap = page->m_heap;
+	if (heap == s_heap) {
+		freeLocal(heap, page, block);
+	} else {
+		// Another thread (or the owner thread after its heap release) : push on remote stack.
+		void* head;
+		do {
+			head			= page->m_remoteFree;
+			*(void**)block	= head;
+		} while (ATOMICCASPTR(&page->m_remoteFree, head, block) != head);
+
+		// First block : page is not queued in its heap (owner empty remoteFree only after dequeue).
+		if (!head) {
+			void* pageHead;
+			do {
+				pageHead			= heap->m_remotePages;
+				page->m_remoteNext	= (Page*)pageHead;
+			} while (ATOMICCASPTR(&heap->m_remotePages, pageHead, page) != pageHead);
+		}
+	}
+}
+
+//
+// Large allocation
+//
+
+/** Best fit cached mapping of at least mapSize (and at most twice), NULL if none. */
+u8* takeLargeCache(Heap* heap, size_t mapSize) {
+	if (!heap) { return NULL; }
+
+	u32 best = LX_MALLOC_LARGE_CACHE_COUNT;
+	size_t bestSize = (mapSize > (((size_t)-1) >> 1)) ? ((size_t)-1) : (mapSize << 1);
+	for (u32 n = 0; n < heap->m_largeCount; n++) {
+		size_t size = *(size_t*)heap->m_largeCache[n];
+		if (size >= mapSize && size <= bestSize) {
+			best		= n;
+			bestSize	= size;
+		}
+	}
+	if (best == LX_MALLOC_LARGE_CACHE_COUNT) { return NULL; }
+
+	u8* base = heap->m_largeCache[best];
+	heap->m_largeCount--;
+	memmove(&heap->m_largeCache[best], &heap->m_largeCache[best + 1], (heap->m_largeCount - best) * sizeof(u8*));
+	heap->m_largeSize -= bestSize;
+	return base;
+}
+
+void freeLarge(u8* base) {
+	size_t mapSize	= *(size_t*)base;
+	Heap* heap		= s_heap;
+	if (!heap || mapSize > LX_MALLOC_LARGE_CACHE_SIZE / 4) {
+		munmap(base, mapSize);
+		return;
+	}
+
+	// Keep it as the newest, unmap the oldest ones over budget.
+	heap->m_largeCache[heap->m_largeCount++] = base;
+	heap->m_largeSize += mapSize;
+	while (heap->m_largeCount == LX_MALLOC_LARGE_CACHE_COUNT || heap->m_largeSize > LX_MALLOC_LARGE_CACHE_SIZE) {
+		u8* old = heap->m_largeCache[0];
+		heap->m_largeSize -= *(size_t*)old;
+		heap->m_largeCount--;
+		memmove(&heap->m_largeCache[0], &heap->m_largeCache[1], heap->m_largeCount * sizeof(u8*));
+		munmap(old, *(size_t*)old);
+	}
+}
+
+void* allocateLarge(size_t size, size_t alignment) {
+	size_t extra = (alignment > LX_MALLOC_ALIGN) ? alignment : 0;
+	if (size > ((size_t)-1) - (LX_LARGE_OFFSET + extra + pageSize())) { return NULL; }
+
+	size_t mapSize	= alignUp(LX_LARGE_OFFSET + size + extra, pageSize());
+	Heap* heap		= s_heap ? s_heap : acquireHeap();	// Cache is per heap. NULL for an exiting thread.
+	u8* base		= takeLargeCache(heap, mapSize);
+	if (base) {
+		((size_t*)base)[1] = 1;
+	} else {
+		base = (u8*)mapMemory(mapSize);
+		if (!base) { return NULL; }
+		*(size_t*)base = mapSize;		// Reused flag already 0.
+	}
+
+	u8* ptr			= (u8*)alignUp((size_t)&base[LX_LARGE_OFFSET], (alignment > LX_MALLOC_ALIGN) ? alignment : LX_MALLOC_ALIGN);
+	BlockHeader* h	= ((BlockHeader*)ptr) - 1;
+	h->m_owner		= NULL;
+	h->m_block		= base;
+	return ptr;
+}
+
+//
+// Common entry points
+//
+
+void* lxMalloc(size_t size, size_t alignment = LX_MALLOC_ALIGN) {
+	if (alignment <= LX_MALLOC_ALIGN) {
+		if (size <= LX_MALLOC_SMALL_MAX) {
+			Page* owner;
+			BlockHeader* h = (BlockHeader*)allocateBlock(sizeToClass(size), &owner);
+			if (h) {
+				h->m_owner = owner;
+				h->m_block = h;
+				return h + 1;
+			}
+			if (!s_exiting) { return NULL; }
+		}
+	} else if (alignment < LX_MALLOC_SMALL_MAX && size <= LX_MALLOC_SMALL_MAX - (alignment - LX_MALLOC_ALIGN)) {
+		// Over allocate, header is written just before the aligned pointer inside the block.
+		Page* owner;
+		u8* block = (u8*)allocateBlock(sizeToClass(size + alignment - LX_MALLOC_ALIGN), &owner);
+		if (block) {
+			u8* ptr			= (u8*)alignUp((size_t)&block[sizeof(BlockHeader)], alignment);
+			BlockHeader* h	= ((BlockHeader*)ptr) - 1;
+			h->m_owner		= owner;
+			h->m_block		= block;
+			return ptr;
+		}
+		if (!s_exiting) { return NULL; }
+	}
+	// Large, or thread without heap after its release.
+	return allocateLarge(size, alignment);
+}
+
+void lxFree(void* ptr) {
+	if (!ptr) { return; }
+
+	BlockHeader* h = ((BlockHeader*)ptr) - 1;
+	if (h->m_owner) {
+		freeBlock(h->m_owner, h->m_block);
+	} else {
+		freeLarge((u8*)h->m_block);
+	}
+}
+
+size_t lxUsableSize(void* ptr) {
+	if (!ptr) { return 0; }
+
+	BlockHeader* h	= ((BlockHeader*)ptr) - 1;
+	u8* end			= h->m_owner	? &((u8*)h->m_block)[sizeof(BlockHeader) + h->m_owner->m_classSize]
+								: &((u8*)h->m_block)[*(size_t*)h->m_block];
+	return end - (u8*)ptr;
+}
+
+void* lxRealloc(void* ptr, size_t size) {
+	if (!ptr)	{ return lxMalloc(size); }
+	if (!size)	{ lxFree(ptr); return NULL; }	// Same as glibc.
+
+	BlockHeader* h	= ((BlockHeader*)ptr) - 1;
+	size_t usable	= lxUsableSize(ptr);
+
+#if defined(MREMAP_MAYMOVE)
+	// Large to large : let the kernel move the pages, offset inside first page is preserved.
+	if (!h->m_owner && size > LX_MALLOC_SMALL_MAX && (size_t)((u8*)ptr - (u8*)h->m_block) < pageSize()) {
+		size_t offset	= (u8*)ptr - (u8*)h->m_block;
+		if (size > ((size_t)-1) - (offset + pageSize())) { return NULL; }
+		size_t oldSize	= *(size_t*)h->m_block;
+		size_t newSize	= alignUp(offset + size, pageSize());
+		if (newSize == oldSize) { return ptr; }
+
+		void* base = mremap(h->m_block, oldSize, newSize, MREMAP_MAYMOVE);
+		if (base == MAP_FAILED) { return NULL; }
+		*(size_t*)base = newSize;
+		BlockHeader* nh = (BlockHeader*)&((u8*)base)[offset] - 1;
+		nh->m_block = base;
+		return &((u8*)base)[offset];
+	}
+#endif
+
+	if (size <= usable) {
+		Page* page = h->m_owner;
+		if (page) {
+			// Keep the block unless the new size fit in a much smaller class.
+			if (size >= (page->m_classSize >> 1) || page->m_sizeClass == 0) { return ptr; }
+		} else if (size > LX_MALLOC_SMALL_MAX) {
+			return ptr;
+		}
+	}
+
+	void* res = lxMalloc(size);
+	if (res) {
+		memcpy(res, ptr, (usable < size) ? usable : size);
+		lxFree(ptr);
+	}
+	return res;
+}
+
+void* lxAlignedMalloc(size_t alignment, size_t size) {
+	if (alignment == 0 || (alignment & (alignment - 1))) { return NULL; }
+	return lxMalloc(size, alignment);
+}
+
+void* lxNew(size_t size, size_t alignment = LX_MALLOC_ALIGN) {
+	for (;;) {
+		void* res = lxMalloc(size, alignment);
+		if (res) { return res; }
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) { throw std::bad_alloc(); }
+		handler();
+	}
+}
+
+void* lxNewNoThrow(size_t size, size_t alignment = LX_MALLOC_ALIGN) noexcept {
+	try {
+		return lxNew(size, alignment);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+}
+
+//=========================================================================================
+//  C interface
+//=========================================================================================
+LX_EXPORT void* malloc(size_t size) noexcept {
+	void* res = lxMalloc(size);
+	if (!res) { errno = ENOMEM; }
+	return res;
+}
+
+LX_EXPORT void free(void* ptr) noexcept {
+	lxFree(ptr);
+}
+
+LX_EXPORT void* calloc(size_t count, size_t size) noexcept {
+	size_t total;
+	if (__builtin_mul_overflow(count, size, &total)) { errno = ENOMEM; return NULL; }
+
+	void* res = lxMalloc(total);
+	if (!res) { errno = ENOMEM; return NULL; }
+	BlockHeader* h = (BlockHeader*)res - 1;
+	if (h->m_owner || ((size_t*)h->m_block)[1]) {
+		memset(res, 0, total);	// Large allocation is already zeroed by mmap, unless reused.
+	}
+	return res;
+}
+
+LX_EXPORT void* realloc(void* ptr, size_t size) noexcept {
+	void* res = lxRealloc(ptr, size);
+	if (!res && size) { errno = ENOMEM; }
+	return res;
+}
+
+LX_EXPORT void* reallocarray(void* ptr, size_t count, size_t size) noexcept {
+	size_t total;
+	if (__builtin_mul_overflow(count, size, &total)) { errno = ENOMEM; return NULL; }
+	return realloc(ptr, total);
+}
+
+LX_EXPORT int posix_memalign(void** res, size_t alignment, size_t size) noexcept {
+	if (alignment == 0 || alignment % sizeof(void*) || (alignment & (alignment - 1))) { return EINVAL; }
+	void* ptr = lxAlignedMalloc(alignment, size);
+	if (!ptr) { return ENOMEM; }
+	*res = ptr;
+	return 0;
+}
+
+LX_EXPORT void* aligned_alloc(size_t alignment, size_t size) noexcept {
+	void* res = lxAlignedMalloc(alignment, size);
+	if (!res) { errno = (alignment && !(alignment & (alignment - 1))) ? ENOMEM : EINVAL; }
+	return res;
+}
+
+LX_EXPORT void* memalign(size_t alignment, size_t size) noexcept {
+	// Same as glibc : alignment is rounded up to the next power of 2 instead of failing.
+	if (alignment <= LX_MALLOC_ALIGN) {
+		alignment = LX_MALLOC_ALIGN;
+	} else if (alignment & (alignment - 1)) {
+		if (alignment > (((size_t)-1) >> 1) + 1) { errno = EINVAL; return NULL; }
+		alignment = ((size_t)1) << (sizeof(size_t) * 8 - __builtin_clzl(alignment));
+	}
+
+	void* res = lxMalloc(size, alignment);
+	if (!res) { errno = ENOMEM; }
+	return res;
+}
+
+LX_EXPORT void* valloc(size_t size) noexcept {
+	return aligned_alloc(pageSize(), size);
+}
+
+LX_EXPORT void* pvalloc(size_t size) noexcept {
+	if (size > ((size_t)-1) - pageSize()) { errno = ENOMEM; return NULL; }	// Rounding would wrap to 0.
+	return aligned_alloc(pageSize(), alignUp(size ? size : 1, pageSize()));
+}
+
+LX_EXPORT size_t malloc_usable_size(void* ptr) noexcept {
+	return lxUsableSize(ptr);
+}
+
+//=========================================================================================
+//  C++ interface
+//=========================================================================================
+void* operator new		(size_t size)								{ return lxNew(size);			}
+void* operator new[]	(size_t size)								{ return lxNew(size);			}
+void* operator new		(size_t size, const std::nothrow_t&) noexcept	{ return lxNewNoThrow(size);	}
+void* operator new[]	(size_t size, const std::nothrow_t&) noexcept	{ return lxNewNoThrow(size);	}
+
+void operator delete	(void* ptr) noexcept							{ lxFree(ptr); }
+void operator delete[]	(void* ptr) noexcept							{ lxFree(ptr); }
+void operator delete	(void* ptr, const std::nothrow_t&) noexcept	{ lxFree(ptr); }
+void operator delete[]	(void* ptr, const std::nothrow_t&) noexcept	{ lxFree(ptr); }
+
+#if __cplusplus >= 201402L
+void operator delete	(void* ptr, size_t) noexcept					{ lxFree(ptr); }
+void operator delete[]	(void* ptr, size_t) noexcept					{ lxFree(ptr); }
+#endif
+
+#if defined(__cpp_aligned_new)
+void* operator new		(size_t size, std::align_val_t al)									{ return lxNew(size, (size_t)al);		}
+void* operator new[]	(size_t size, std::align_val_t al)									{ return lxNew(size, (size_t)al);		}
+void* operator new		(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept	{ return lxNewNoThrow(size, (size_t)al);	}
+void* operator new[]	(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept	{ return lxNewNoThrow(size, (size_t)al);	}
+
+void operator delete	(void* ptr, std::align_val_t) noexcept							{ lxFree(ptr); }
+void operator delete[]	(void* ptr, std::align_val_t) noexcept							{ lxFree(ptr); }
+void operator delete	(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept	{ lxFree(ptr); }
+void operator delete[]	(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept	{ lxFree(ptr); }
+void operator delete	(void* ptr, size_t, std::align_val_t) noexcept					{ lxFree(ptr); }
+void operator delete[]	(void* ptr, size_t, std::align_val_t) noexcept					{ lxFree(ptr); }
+#endif
+
+#endif // !USE_WINDOWS_API
@@ -0,0 +1,395 @@
+/*
+	Stress test and benchmark for lxMallocOverride.cpp
+	===================================================
+
+	Run the same binary with and without the library to compare with the system allocator :
+
+		g++ -std=c++17 -O2 -fno-builtin lxMallocTest.cpp -o lxMallocTest -lpthread
+		./lxMallocTest
+		LD_PRELOAD=./liblxmalloc.so ./lxMallocTest
+
+	-fno-builtin is needed, else the compiler may remove malloc/free pairs.
+	Return 0 when all checks pass, print the failing check and return 1 else.
+*/
+
+#include <new>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "lxTypes.h"
+
+static int s_failCount = 0;
+
+#define CHECK(cond)		{ if (!(cond)) { printf("FAILED line %d : %s\n", __LINE__, #cond); s_failCount++; } }
+
+static double now() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static bool isFilled(const void* ptr, u8 value, size_t size) {
+	const u8* p = (const u8*)ptr;
+	for (size_t n = 0; n < size; n++) {
+		if (p[n] != value) { return false; }
+	}
+	return true;
+}
+
+static u32 nextRandom(u32& seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// =================================================
+//  Functional tests
+// =================================================
+
+static void testCalloc() {
+	static const size_t sizes[] = { 1, 24, 1000, 40000, 200000, 300000, 4*1024*1024 };
+	for (u32 n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		// Dirty a block of the same size first, calloc is likely to get it back.
+		void* dirty = malloc(sizes[n]);
+		memset(dirty, 0xFF, sizes[n]);
+		free(dirty);
+
+		void* ptr = calloc(1, sizes[n]);
+		CHECK(ptr && isFilled(ptr, 0, sizes[n]));
+		free(ptr);
+	}
+
+	volatile size_t hugeCount = ((size_t)-1) / 2;	// volatile : avoid compile time overflow warning.
+	errno = 0;
+	CHECK(calloc(hugeCount, 4) == NULL && errno == ENOMEM);
+}
+
+static void testAlign() {
+	for (size_t alignment = sizeof(void*); alignment <= 65536; alignment <<= 1) {
+		void* ptr = NULL;
+		CHECK(posix_memalign(&ptr, alignment, 100) == 0 && ((size_t)ptr & (alignment - 1)) == 0);
+		memset(ptr, 0x5A, 100);
+
+		// Realloc of an aligned block keep the content.
+		ptr = realloc(ptr, 100000);
+		CHECK(ptr && isFilled(ptr, 0x5A, 100));
+		free(ptr);
+
+		ptr = aligned_alloc(alignment, 300000);
+		CHECK(ptr && ((size_t)ptr & (alignment - 1)) == 0);
+		free(ptr);
+	}
+
+	void* ptr;
+	CHECK(posix_memalign(&ptr, 24, 100) == EINVAL);
+	CHECK(posix_memalign(&ptr, 0, 100) == EINVAL);
+
+	// glibc memalign round up alignment to the next power of 2.
+	ptr = memalign(48, 100);
+	CHECK(ptr && ((size_t)ptr & 63) == 0);
+	free(ptr);
+}
+
+static void testRealloc() {
+	// Small -> medium -> large -> larger (mremap) -> small -> large.
+	static const size_t sizes[] = { 10, 5000, 100000, 300000, 3*1024*1024, 100, 500000 };
+	u8* ptr = NULL;
+	size_t prevSize = 0;
+	for (u32 n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		ptr = (u8*)realloc(ptr, sizes[n]);
+		CHECK(ptr && malloc_usable_size(ptr) >= sizes[n]);
+		size_t keep = (prevSize < sizes[n]) ? prevSize : sizes[n];
+		CHECK(isFilled(ptr, (u8)n, keep));
+		memset(ptr, n + 1, sizes[n]);
+		prevSize = sizes[n];
+	}
+	free(ptr);
+
+	// Shrink to a much smaller size must not keep the big block.
+	ptr = (u8*)malloc(200000);
+	memset(ptr, 0x33, 200000);
+	ptr = (u8*)realloc(ptr, 10);
+	CHECK(ptr && isFilled(ptr, 0x33, 10) && malloc_usable_size(ptr) < 1000);
+	free(ptr);
+
+	CHECK(realloc(malloc(10), 0) == NULL);
+}
+
+static void testNew() {
+	int* array = new int[1000];
+	array[999] = 1;
+	delete[] array;
+
+	void* ptr = ::operator new(100000, std::nothrow);
+	CHECK(ptr != NULL);
+	::operator delete(ptr);
+
+#if defined(__cpp_aligned_new)
+	struct alignas(256) Aligned { u8 data[256]; };
+	Aligned* obj = new Aligned;
+	CHECK(((size_t)obj & 255) == 0);
+	delete obj;
+#endif
+}
+
+//
+// Cross thread free : each thread free the blocks allocated by the previous one.
+//
+
+#define CROSS_THREAD	4
+#define CROSS_SLOT		4096
+
+static void* volatile	s_crossSlot[CROSS_THREAD][CROSS_SLOT];
+static pthread_barrier_t	s_crossBarrier;
+
+static void* crossThread(void* arg) {
+	size_t	id		= (size_t)arg;
+	u32		seed	= (u32)id + 1;
+
+	for (u32 round = 0; round < 4; round++) {
+		for (u32 n = 0; n < CROSS_SLOT; n++) {
+			size_t size = nextRandom(seed) % 1024;
+			u8* ptr = (u8*)malloc(size + 1);
+			ptr[0] = (u8)id;
+			ptr[size] = (u8)id;
+			s_crossSlot[id][n] = ptr;
+		}
+		pthread_barrier_wait(&s_crossBarrier);
+
+		void* volatile* other = s_crossSlot[(id + 1) % CROSS_THREAD];
+		for (u32 n = 0; n < CROSS_SLOT; n++) {
+			u8* ptr = (u8*)other[n];
+			if (ptr[0] != (u8)((id + 1) % CROSS_THREAD)) { return (void*)1; }
+			free(ptr);
+		}
+		pthread_barrier_wait(&s_crossBarrier);
+	}
+	return NULL;
+}
+
+static void testCrossThread() {
+	pthread_t threads[CROSS_THREAD];
+	pthread_barrier_init(&s_crossBarrier, NULL, CROSS_THREAD);
+	for (size_t n = 0; n < CROSS_THREAD; n++) {
+		pthread_create(&threads[n], NULL, crossThread, (void*)n);
+	}
+	for (size_t n = 0; n < CROSS_THREAD; n++) {
+		void* res;
+		pthread_join(threads[n], &res);
+		CHECK(res == NULL);
+	}
+	pthread_barrier_destroy(&s_crossBarrier);
+}
+
+//
+// Heap adoption : many short lived thread must not grow the process.
+//
+
+static size_t virtualSize() {
+	size_t pages = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f) {
+		if (fscanf(f, "%zu", &pages) != 1) { pages = 0; }
+		fclose(f);
+	}
+	return pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void* shortThread(void*) {
+	void* ptrs[64];
+	for (u32 n = 0; n < 64; n++) { ptrs[n] = malloc(16 << (n & 7)); }
+	for (u32 n = 0; n < 64; n++) { free(ptrs[n]); }
+	return NULL;
+}
+
+static void testThreadExit() {
+	// Warm up, then 2000 threads one after the other.
+	pthread_t thread;
+	pthread_create(&thread, NULL, shortThread, NULL);
+	pthread_join(thread, NULL);
+
+	size_t before = virtualSize();
+	for (u32 n = 0; n < 2000; n++) {
+		pthread_create(&thread, NULL, shortThread, NULL);
+		pthread_join(thread, NULL);
+	}
+	size_t after	= virtualSize();
+	size_t growth	= (after > before) ? after - before : 0;
+	CHECK(growth < 32*1024*1024);
+}
+
+//
+// Memory of freed blocks must be given back to the OS.
+//
+
+static size_t residentSize() {
+	size_t pages = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f) {
+		if (fscanf(f, "%zu %zu", &pages, &resident) != 2) { resident = 0; }
+		fclose(f);
+	}
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void testRelease() {
+	static const u32 count = 4000000;
+	void** ptrs = (void**)malloc(count * sizeof(void*));
+	memset(ptrs, 0, count * sizeof(void*));		// Resident before measure.
+	size_t before = residentSize();
+	for (u32 n = 0; n < count; n++) { ptrs[n] = malloc(64); memset(ptrs[n], 1, 64); }
+	for (u32 n = 0; n < count; n++) { free(ptrs[n]); }
+	malloc_trim(0);		// glibc keep small chunks until trimmed, no effect with lx.
+	size_t after	= residentSize();
+	size_t growth	= (after > before) ? after - before : 0;
+	free(ptrs);
+	CHECK(growth < 16*1024*1024);
+}
+
+//
+// Fork while other threads are allocating : child must not deadlock.
+//
+
+static volatile bool s_forkStop = false;
+
+static void* forkWorker(void* arg) {
+	u32 seed = (u32)(size_t)arg;
+	void* slots[256] = {};
+	while (!s_forkStop) {
+		u32 n = nextRandom(seed) & 255;
+		free(slots[n]);
+		slots[n] = malloc(nextRandom(seed) % 70000);
+	}
+	for (u32 n = 0; n < 256; n++) { free(slots[n]); }
+	return NULL;
+}
+
+static void* forkChildThread(void* arg) {
+	free(arg);					// Free a block of the main thread of the child.
+	return malloc(100);
+}
+
+static void testFork() {
+	pthread_t workers[4];
+	for (size_t n = 0; n < 4; n++) {
+		pthread_create(&workers[n], NULL, forkWorker, (void*)(n + 1));
+	}
+
+	void* parentBlock = malloc(200);
+	for (u32 n = 0; n < 20; n++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			alarm(10);			// A deadlock kill the child -> test fail.
+			free(parentBlock);
+			for (u32 i = 0; i < 10000; i++) { free(malloc(i % 300000)); }
+			pthread_t thread;
+			void* res;
+			pthread_create(&thread, NULL, forkChildThread, malloc(64));
+			pthread_join(thread, &res);
+			free(res);			// Block of an exited thread.
+			_exit(0);
+		}
+
+		int status = -1;
+		waitpid(pid, &status, 0);
+		CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	free(parentBlock);
+
+	s_forkStop = true;
+	for (u32 n = 0; n < 4; n++) { pthread_join(workers[n], NULL); }
+}
+
+// =================================================
+//  Benchmark, in million allocation per second (same as Benchmark.txt)
+// =================================================
+
+#define BENCH_SLOT		256
+
+struct BenchParam {
+	size_t	minSize;
+	size_t	maxSize;
+	u32		count;
+	double	time;
+};
+
+static void* benchThread(void* arg) {
+	BenchParam* param	= (BenchParam*)arg;
+	void* slots[BENCH_SLOT] = {};
+	u32 seed			= 1;
+	size_t range		= param->maxSize - param->minSize + 1;
+
+	double start = now();
+	for (u32 n = 0; n < param->count; n++) {
+		u32 slot = n & (BENCH_SLOT - 1);
+		free(slots[slot]);
+		slots[slot] = malloc(param->minSize + nextRandom(seed) % range);
+	}
+	for (u32 n = 0; n < BENCH_SLOT; n++) { free(slots[n]); }
+	param->time = now() - start;
+	return NULL;
+}
+
+static void bench(const char* name, size_t minSize, size_t maxSize, u32 count, u32 threadCount) {
+	pthread_t	threads[16];
+	BenchParam	params [16];
+	for (u32 n = 0; n < threadCount; n++) {
+		params[n].minSize	= minSize;
+		params[n].maxSize	= maxSize;
+		params[n].count		= count;
+		pthread_create(&threads[n], NULL, benchThread, &params[n]);
+	}
+
+	double time = 0.0;
+	for (u32 n = 0; n < threadCount; n++) {
+		pthread_join(threads[n], NULL);
+		time += params[n].time;
+	}
+	time /= threadCount;
+	printf("\t%-24s %2u Thread	%8.2f M/Sec (/Thread)\n", name, threadCount, (count / time) * 1e-6);
+}
+
+static void benchGrowth(u32 count) {
+	// Long lived allocation, never freed until the end.
+	void** ptrs = (void**)malloc(count * sizeof(void*));
+	double start = now();
+	for (u32 n = 0; n < count; n++) { ptrs[n] = malloc(16); }
+	double time = now() - start;
+	for (u32 n = 0; n < count; n++) { free(ptrs[n]); }
+	free(ptrs);
+	printf("\t%-24s  1 Thread	%8.2f M/Sec\n", "16 byte, no free", (count / time) * 1e-6);
+}
+
+int main() {
+	testCalloc();
+	testAlign();
+	testRealloc();
+	testNew();
+	testCrossThread();
+	testThreadExit();
+	testRelease();
+	testFork();
+
+	printf("Allocation + free in million per seconds :\n");
+	bench("16..512 byte",			16,		512,	 20000000, 1);
+	bench("16..512 byte",			16,		512,	 20000000, 4);
+	bench("1..32KB",				1,		32768,	  5000000, 1);
+	bench("40KB",					40000,	41000,	  2000000, 1);
+	bench("40KB",					40000,	41000,	  2000000, 4);
+	bench("300KB..1MB (mmap)",		300000,	1000000,    20000, 1);
+	benchGrowth(8000000);
+
+	if (s_failCount) {
+		printf("%d check(s) FAILED\n", s_failCount);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -1,6 +1,8 @@
 #ifndef LX_PLATFORM_H
 #define LX_PLATFORM_H
 
+#include "lxTypes.h"
+
 #if defined(_WIN32) || defined(_WIN64) || defined(OS_WINDOWS)
 	#if defined(_MSC_VER)		// Visual Studio
 		#include <intrin.h>
@@ -24,9 +26,23 @@ namespace lx {
 			#define ATOMICINCREMENTPTR(a,b)	_InterlockedExchangeAdd((volatile long*)a,b);
 		#endif
 	#elif defined(__GNUC__)		// Clang, LLVM, GNU C++, Intel ICC, ICPC
-		//
-		// TODO Increment Atomic 64 and 32 bit with GNU C
-		//
+		// Return value BEFORE increment, same as Interlocked version.
+		// Pointer is incremented as an integer (byte count), not scaled by pointed type.
+		#define ATOMICINCREMENT32(a,b)	__sync_fetch_and_add((volatile u32*)a,b)
+		#define ATOMICINCREMENTPTR(a,b)	__sync_fetch_and_add((volatile size_t*)a,b)
+	#endif
+
+	//
+	// Atomic pointer exchange / compare and swap (full barrier).
+	// ATOMICEXCHANGEPTR return the previous value.
+	// ATOMICCASPTR      return the previous value, swap done if it equals 'cmp'.
+	//
+	#if defined(USE_WINDOWS_API)
+		#define ATOMICEXCHANGEPTR(a,v)		_InterlockedExchangePointer((void* volatile*)a,v)
+		#define ATOMICCASPTR(a,cmp,v)		_InterlockedCompareExchangePointer((void* volatile*)a,v,cmp)
+	#elif defined(__GNUC__)
+		#define ATOMICEXCHANGEPTR(a,v)		__atomic_exchange_n((void* volatile*)a,v,__ATOMIC_SEQ_CST)
+		#define ATOMICCASPTR(a,cmp,v)		__sync_val_compare_and_swap((void* volatile*)a,cmp,v)
 	#endif
 }
 
@@ -3,6 +3,8 @@
 
 #if defined(_WIN32) || defined(_WIN64) || defined(OS_WINDOWS)
 #include <Windows.h>
+#else
+#include <pthread.h>
 #endif
 
 namespace lx {
@@ -13,6 +15,13 @@ namespace lx {
 		#define DESTROYLOCK(a)			DeleteCriticalSection(a);
 		#define LOCK(a)					EnterCriticalSection(a);
 		#define UNLOCK(a)				LeaveCriticalSection(a);
+	#else
+		typedef pthread_mutex_t			LockType;
+
+		#define CREATELOCK(a)			pthread_mutex_init(a, NULL);
+		#define DESTROYLOCK(a)			pthread_mutex_destroy(a);
+		#define LOCK(a)					pthread_mutex_lock(a);
+		#define UNLOCK(a)				pthread_mutex_unlock(a);
 	#endif
 }
 
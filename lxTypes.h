@@ -1,6 +1,9 @@
 #ifndef LX_TYPES_H
 #define LX_TYPES_H
 
+#include <stdio.h>	// printf used by lxAssert
+#include <stddef.h>	// size_t
+
 typedef unsigned long long	u64;
 typedef int					s32;
 typedef unsigned int		u32;